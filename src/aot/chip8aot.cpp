@@ -0,0 +1,412 @@
+/*
+ * chip8aot: ahead-of-time ROM to C++ translator.
+ *
+ * Walks a ROM from ROM_LOCATION along its static control flow (fallthrough, 1NNN, 2NNN and the
+ * return address after it, both sides of every skip) and emits one C++ function per basic block.
+ * The functions operate directly on Chip8 state. A generated Run() switches on pc to chain them
+ * without going back through Chip8::Run() for every block.
+ *
+ * Anything that cannot be resolved statically is left to the interpreter: BNNN computed jumps,
+ * unknown opcodes and anything past the end of the ROM simply have no block, so Chip8::Run()
+ * falls back to Step() there. Instructions that write memory (FX33, FX55) end their block, and no
+ * block is run once its source bytes have been overwritten.
+ */
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/chip8.h"
+
+namespace {
+
+constexpr int EXIT_CODE_ERR = 1;
+constexpr size_t MAX_BLOCK_LENGTH = 256;  ///< longest block we emit, to keep the budget check useful
+
+std::string Hex(unsigned value, int width) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "0x%0*X", width, value);
+  return buf;
+}
+
+/**
+ * \brief Static translator for a single ROM.
+ */
+class Translator {
+ public:
+  Translator(std::string name, std::vector<uint8_t> rom) : name_(std::move(name)), rom_(std::move(rom)) {}
+
+  /**
+   * Discover and translate every block reachable from ROM_LOCATION.
+   */
+  void Translate() {
+    std::vector<uint16_t> worklist{chip8::ROM_LOCATION};
+    std::set<uint16_t> seen;
+    while (!worklist.empty()) {
+      uint16_t address = worklist.back();
+      worklist.pop_back();
+      if (!InRom(address) || !seen.insert(address).second) {
+        continue;
+      }
+      for (uint16_t successor : TranslateBlock(address)) {
+        worklist.push_back(successor);
+      }
+    }
+  }
+
+  /**
+   * Write the translated program as a C++ translation unit.
+   * @param out destination stream
+   */
+  void Emit(std::ostream &out) const {
+    out << "// Generated by chip8aot from " << name_ << ", do not edit.\n"
+        << "#include <algorithm>\n\n"
+        << "#include \"include/chip8.h\"\n\n"
+        << "namespace chip8 {\n\n"
+        << "class Translated {\n"
+        << " public:\n";
+    for (const auto &entry : blocks_) {
+      out << "  static inline void " << FunctionName(entry.first) << "(Chip8 &c) {\n"
+          << entry.second.body
+          << "  }\n\n";
+    }
+    out << "  // runs blocks for as long as they fit the budget and are still intact, returns instructions executed\n"
+        << "  static uint64_t Run(Chip8 &c, uint64_t budget) {\n"
+        << "    uint64_t executed = 0;\n"
+        << "    for (;;) {\n"
+        << "      switch (c.pc_) {\n";
+    for (const auto &entry : blocks_) {
+      char lines[32];
+      std::snprintf(lines, sizeof(lines), "0x%016llXull", static_cast<unsigned long long>(entry.second.lines));
+      out << "        case " << Hex(entry.first, 3) << ": {\n"
+          << "          if (budget - executed < " << entry.second.length << " || (c.dirty_lines_ & " << lines
+          << ") != 0) { return executed; }\n"
+          << "          " << FunctionName(entry.first) << "(c);\n"
+          << "          executed += " << entry.second.length << ";\n"
+          << "          break;\n"
+          << "        }\n";
+    }
+    out << "        default: return executed;\n"
+        << "      }\n"
+        << "    }\n"
+        << "  }\n"
+        << "};\n\n"
+        << "namespace {\n\n"
+        << "constexpr uint8_t ROM[] = {";
+    for (size_t i = 0; i < rom_.size(); i++) {
+      out << (i % 16 == 0 ? "\n    " : " ") << Hex(rom_[i], 2) << ",";
+    }
+    out << "\n};\n\n"
+        << "constexpr uint8_t CODE_MAP[] = {";
+    for (size_t i = 0; i < code_map_.size(); i++) {
+      out << (i % 16 == 0 ? "\n    " : " ") << Hex(code_map_[i], 2) << ",";
+    }
+    out << "\n};\n\n"
+        << "}  // namespace\n\n"
+        << "extern const TranslatedProgram TRANSLATED_PROGRAM{\n"
+        << "    \"" << name_ << "\", ROM, sizeof(ROM), " << blocks_.size() << ", CODE_MAP, &Translated::Run\n"
+        << "};\n\n"
+        << "}  // namespace chip8\n";
+  }
+
+  size_t NumBlocks() const { return blocks_.size(); }
+
+ private:
+  struct Block {
+    uint16_t length;  ///< instructions in the block
+    uint64_t lines;   ///< memory lines the block was translated from
+    std::string body; ///< C++ statements
+  };
+
+  bool InRom(uint16_t address) const {
+    return address >= chip8::ROM_LOCATION && address + 1u < chip8::ROM_LOCATION + rom_.size();
+  }
+
+  uint16_t OpcodeAt(uint16_t address) const {
+    size_t offset = address - chip8::ROM_LOCATION;
+    return static_cast<uint16_t>(rom_[offset] << 8u | rom_[offset + 1]);
+  }
+
+  static std::string FunctionName(uint16_t address) {
+    return "Block_" + Hex(address, 3).substr(2);
+  }
+
+  /** @return whether the instruction is left to the interpreter */
+  static bool Untranslatable(uint16_t opcode) {
+    auto NN = opcode & 0x00FFu;
+    auto N = opcode & 0x000Fu;
+    switch (opcode & 0xF000u) {
+      case 0x0000: return NN != 0xE0 && NN != 0xEE;
+      case 0x8000: return N > 0x7 && N != 0xE;
+      case 0xB000: return true;
+      case 0xE000: return NN != 0x9E && NN != 0xA1;
+      case 0xF000: {
+        switch (NN) {
+          case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E: case 0x29: case 0x33: case 0x55:
+          case 0x65: return false;
+          default: return true;
+        }
+      }
+      default: return false;
+    }
+  }
+
+  /**
+   * Translate the block starting at address, if there is one.
+   * @return addresses control may continue at after this block
+   */
+  std::vector<uint16_t> TranslateBlock(uint16_t start) {
+    if (Untranslatable(OpcodeAt(start))) {
+      return {};
+    }
+
+    std::ostringstream body;
+    std::vector<uint16_t> successors;
+    uint16_t address = start;
+    uint16_t length = 0;
+    uint32_t pending_ticks = 0;  // instructions whose timer tick has not been emitted yet
+    bool ended = false;
+
+    auto flush_ticks = [&]() {
+      if (pending_ticks > 0) {
+        body << "    if ((c.delay_timer_ | c.sound_timer_) != 0) { c.Tick(" << pending_ticks << "); }\n";
+        pending_ticks = 0;
+      }
+    };
+    // tick for everything so far including the current instruction
+    auto flush_ticks_through = [&]() {
+      pending_ticks++;
+      flush_ticks();
+    };
+
+    while (!ended) {
+      uint16_t opcode = OpcodeAt(address);
+      auto X = (opcode & 0x0F00u) >> 8u;
+      auto Y = (opcode & 0x00F0u) >> 4u;
+      auto NNN = opcode & 0x0FFFu;
+      auto NN = opcode & 0x00FFu;
+      auto N = opcode & 0x000Fu;
+      std::string VX = "c.V_[" + Hex(X, 1) + "]";
+      std::string VY = "c.V_[" + Hex(Y, 1) + "]";
+      std::string VF = "c.V_[0xF]";
+      auto next = static_cast<uint16_t>(address + 2);
+      auto skip = static_cast<uint16_t>(address + 4);
+
+      body << "    // " << Hex(address, 3) << ": " << Hex(opcode, 4).substr(2) << "\n";
+      for (unsigned byte = address; byte < address + 2u; byte++) {
+        code_map_[byte / 8] = static_cast<uint8_t>(code_map_[byte / 8] | (1u << (byte % 8)));
+      }
+
+      // skips end the block with both sides as successors
+      auto emit_skip = [&](const std::string &condition) {
+        flush_ticks_through();
+        body << "    c.pc_ = (" << condition << ") ? " << Hex(skip, 3) << " : " << Hex(next, 3) << ";\n";
+        successors = {next, skip};
+        ended = true;
+      };
+
+      // timers are only observed by FX07 and overwritten by FX15/FX18, so ticks are batched up to those
+      bool touches_timers = (opcode & 0xF000u) == 0xF000u && (NN == 0x07 || NN == 0x15 || NN == 0x18);
+      if (touches_timers) {
+        flush_ticks();
+      }
+
+      switch (opcode & 0xF000u) {
+        case 0x0000: {
+          if (NN == 0xE0) {
+            body << "    std::fill(c.gfx_.begin(), c.gfx_.end(), 0);\n"
+                 << "    c.should_redraw_ = true;\n";
+          } else {
+            flush_ticks_through();
+            body << "    c.sp_ = static_cast<uint16_t>((c.sp_ + STACK_LIMIT - 1) % STACK_LIMIT);\n"
+                 << "    c.pc_ = c.stack_[c.sp_];\n"
+                 << "    c.pc_ += 2;\n";
+            ended = true;
+          }
+          break;
+        }
+        case 0x1000: {
+          flush_ticks_through();
+          body << "    c.pc_ = " << Hex(NNN, 3) << ";\n";
+          successors = {static_cast<uint16_t>(NNN)};
+          ended = true;
+          break;
+        }
+        case 0x2000: {
+          flush_ticks_through();
+          body << "    c.stack_[c.sp_] = " << Hex(address, 3) << ";\n"
+               << "    c.sp_ = static_cast<uint16_t>((c.sp_ + 1) % STACK_LIMIT);\n"
+               << "    c.pc_ = " << Hex(NNN, 3) << ";\n";
+          successors = {static_cast<uint16_t>(NNN), next};
+          ended = true;
+          break;
+        }
+        case 0x3000: emit_skip(VX + " == " + Hex(NN, 2)); break;
+        case 0x4000: emit_skip(VX + " != " + Hex(NN, 2)); break;
+        case 0x5000: emit_skip(VX + " == " + VY); break;
+        case 0x6000: body << "    " << VX << " = " << Hex(NN, 2) << ";\n"; break;
+        case 0x7000: body << "    " << VX << " += " << Hex(NN, 2) << ";\n"; break;
+        case 0x8000: {
+          // spelled exactly like Step(), including when X or Y is F
+          body << "    {\n"
+               << "      auto &VX = " << VX << ";\n"
+               << "      auto &VY = " << VY << ";\n"
+               << "      auto &VF = " << VF << ";\n"
+               << "      (void) VY;\n"
+               << "      (void) VF;\n";
+          switch (N) {
+            case 0x0: body << "      VX = VY;\n"; break;
+            case 0x1: body << "      VX |= VY;\n"; break;
+            case 0x2: body << "      VX &= VY;\n"; break;
+            case 0x3: body << "      VX ^= VY;\n"; break;
+            case 0x4: body << "      if (VY > (0xFF - VX)) { VF = 1; }\n"
+                           << "      else { VF = 0; }\n"
+                           << "      VX = VX + VY;\n"; break;
+            case 0x5: body << "      if (VY > VX) { VF = 0; }\n"
+                           << "      else { VF = 1; }\n"
+                           << "      VX = VX - VY;\n"; break;
+            case 0x6: body << "      VF = static_cast<uint8_t>(VX & 0x1u);\n"
+                           << "      VX >>= 1;\n"; break;
+            case 0x7: body << "      if (VX > VY) { VF = 0; }\n"
+                           << "      else { VF = 1; }\n"
+                           << "      VX = VY - VX;\n"; break;
+            case 0xE: body << "      VF = static_cast<uint8_t>(VX >> 0x7u);\n"
+                           << "      VX <<= 1;\n"; break;
+            default: break;
+          }
+          body << "    }\n";
+          break;
+        }
+        case 0x9000: emit_skip(VX + " != " + VY); break;
+        case 0xA000: body << "    c.I_ = " << Hex(NNN, 3) << ";\n"; break;
+        case 0xC000: body << "    " << VX << " = c.rng_(c.rng_eng_) & " << Hex(NN, 2) << ";\n"; break;
+        case 0xD000: {
+          body << "    c.Draw(" << Hex(X, 1) << ", " << Hex(Y, 1) << ", " << Hex(N, 1) << ");\n";
+          break;
+        }
+        case 0xE000: {
+          emit_skip(std::string(NN == 0x9E ? "" : "!") + "c.keys_[" + VX + "]");
+          break;
+        }
+        case 0xF000: {
+          switch (NN) {
+            case 0x07: body << "    " << VX << " = c.delay_timer_;\n"; break;
+            case 0x15: body << "    c.delay_timer_ = " << VX << ";\n"; break;
+            case 0x18: body << "    c.sound_timer_ = " << VX << ";\n"; break;
+            case 0x1E: {
+              body << "    {\n"
+                   << "      auto &VX = " << VX << ";\n"
+                   << "      auto &VF = " << VF << ";\n"
+                   << "      if (c.I_ + VX > 0xFFF) { VF = 1; }\n"
+                   << "      else { VF = 0; }\n"
+                   << "      c.I_ += VX;\n"
+                   << "    }\n";
+              break;
+            }
+            case 0x29: body << "    c.I_ = static_cast<uint16_t>(" << VX << " * 5);\n"; break;
+            case 0x65: body << "    c.LoadRegisters(" << Hex(X, 1) << ");\n"; break;
+            case 0x0A: {
+              // stays put until a key is down, the switch in Run() brings us right back here
+              flush_ticks_through();
+              body << "    c.pc_ = " << Hex(address, 3) << ";\n"
+                   << "    if (c.keys_.any()) {\n"
+                   << "      for (uint8_t i = 0; i < c.keys_.size(); i++) {\n"
+                   << "        if (c.keys_[i]) {\n"
+                   << "          " << VX << " = i;\n"
+                   << "          c.pc_ = " << Hex(next, 3) << ";\n"
+                   << "          break;\n"
+                   << "        }\n"
+                   << "      }\n"
+                   << "    }\n";
+              successors = {address, next};
+              ended = true;
+              break;
+            }
+            case 0x33:
+            case 0x55: {
+              // may overwrite code, so hand control back to Run() to check before going on
+              body << "    c." << (NN == 0x33 ? "StoreBcd(" : "StoreRegisters(") << Hex(X, 1) << ");\n";
+              flush_ticks_through();
+              body << "    c.pc_ = " << Hex(next, 3) << ";\n";
+              successors = {next};
+              ended = true;
+              break;
+            }
+            default: break;
+          }
+          break;
+        }
+        default: break;
+      }
+
+      length++;
+      if (!ended) {
+        pending_ticks++;
+        address = next;
+        if (length >= MAX_BLOCK_LENGTH || !InRom(address) || Untranslatable(OpcodeAt(address))) {
+          // fall through into the next block, or to the interpreter
+          flush_ticks();
+          body << "    c.pc_ = " << Hex(address, 3) << ";\n";
+          successors = {address};
+          ended = true;
+        }
+      } else {
+        address = next;
+      }
+      if (ended) {
+        body << "    c.opcode_ = " << Hex(opcode, 4) << ";\n";
+      }
+    }
+
+    uint64_t lines = 0;
+    for (size_t line = start / chip8::CODE_LINE_SIZE; line <= (address - 1u) / chip8::CODE_LINE_SIZE; line++) {
+      lines |= uint64_t{1} << line;
+    }
+    blocks_[start] = Block{length, lines, body.str()};
+    return successors;
+  }
+
+  std::string name_;                                         ///< ROM name
+  std::vector<uint8_t> rom_;                                 ///< ROM image
+  std::map<uint16_t, Block> blocks_;                         ///< translated blocks by address
+  std::array<uint8_t, chip8::MEMORY_LIMIT / 8> code_map_{};  ///< bit per memory byte blocks were translated from
+};
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    std::cout << "Usage: chip8aot <ROM> <NAME> <OUTPUT.cpp>" << std::endl;
+    return EXIT_CODE_ERR;
+  }
+
+  std::ifstream input(argv[1], std::ios::binary);
+  if (input.fail()) {
+    std::cout << "[ERR/chip8aot] cannot read " << argv[1] << std::endl;
+    return EXIT_CODE_ERR;
+  }
+  std::vector<uint8_t> rom(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>{});
+  if (rom.size() > chip8::MEMORY_LIMIT - chip8::ROM_LOCATION) {
+    std::cout << "[ERR/chip8aot] " << argv[1] << " is too large" << std::endl;
+    return EXIT_CODE_ERR;
+  }
+
+  Translator translator(argv[2], rom);
+  translator.Translate();
+
+  std::ofstream output(argv[3]);
+  translator.Emit(output);
+  if (output.fail()) {
+    std::cout << "[ERR/chip8aot] cannot write " << argv[3] << std::endl;
+    return EXIT_CODE_ERR;
+  }
+
+  std::cout << "chip8aot: " << argv[2] << ", " << translator.NumBlocks() << " blocks" << std::endl;
+  return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * chip8aot_check: differential test of a chip8aot translation against the interpreter.
+ *
+ * Runs the built-in ROM twice from the same seed, once with Step() alone and once with Run() and the
+ * translation, feeding both the same pseudo-random key presses between batches of pseudo-random
+ * size. Batches range from single instructions, which split blocks, to far more than any block.
+ * Machine state has to match after every batch.
+ */
+#include <iostream>
+#include <random>
+
+#include "include/chip8.h"
+
+namespace chip8 {
+extern const TranslatedProgram TRANSLATED_PROGRAM;  ///< generated by chip8aot for this binary
+}  // namespace chip8
+
+namespace {
+
+constexpr int EXIT_CODE_ERR = 1;
+constexpr uint32_t CHECK_SEED = 42;                 ///< seeds both chip8s and the key and batch schedule
+constexpr uint64_t CHECK_INSTRUCTIONS = 3000000;    ///< how far to run
+constexpr uint64_t MAX_BATCH = 1000;                ///< largest batch between key events
+
+}  // namespace
+
+int main() {
+  const auto &program = chip8::TRANSLATED_PROGRAM;
+
+  chip8::Chip8 interpreted;
+  chip8::Chip8 translated;
+  if (!interpreted.Load(program.rom, program.rom_size) || !translated.Load(program.rom, program.rom_size)
+      || !translated.UseTranslation(&program)) {
+    std::cout << "[ERR/chip8aot_check] " << program.name << ": cannot load" << std::endl;
+    return EXIT_CODE_ERR;
+  }
+  for (auto *chip8 : {&interpreted, &translated}) {
+    chip8->Seed(CHECK_SEED);
+    chip8->SetSoundEnabled(false);
+  }
+
+  std::mt19937 schedule(CHECK_SEED);
+  while (interpreted.InstructionCount() < CHECK_INSTRUCTIONS) {
+    int key_index = static_cast<int>(schedule() % chip8::NUM_KEYS);
+    if (schedule() % 2 == 0) {
+      interpreted.KeyDown(key_index);
+      translated.KeyDown(key_index);
+    } else {
+      interpreted.KeyUp(key_index);
+      translated.KeyUp(key_index);
+    }
+
+    // mostly short batches, like the frontend splitting at key events, with the odd long one
+    uint64_t batch = 1 + (schedule() % 4 == 0 ? schedule() % MAX_BATCH : schedule() % 16);
+    uint64_t start = interpreted.InstructionCount();
+    for (uint64_t i = 0; i < batch; i++) {
+      interpreted.Step();
+    }
+    translated.Run(batch);
+
+    if (!interpreted.SameState(translated)) {
+      std::cout << "[ERR/chip8aot_check] " << program.name << ": diverged in the batch of " << batch
+                << " instructions starting at instruction " << start << std::endl;
+      return EXIT_CODE_ERR;
+    }
+  }
+
+  std::cout << "chip8aot_check: " << program.name << ", " << interpreted.InstructionCount()
+            << " instructions match" << std::endl;
+  return 0;
+}
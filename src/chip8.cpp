@@ -1,6 +1,9 @@
+#include <algorithm>
+#include <cassert>
 #include <fstream>
 #include <random>
 #include <iostream>
+#include <vector>
 
 #include "include/chip8.h"
 
@@ -25,7 +28,11 @@ void Chip8::Reset() {
   opcode_ = 0;
   delay_timer_ = 0;
   sound_timer_ = 0;
+  sound_enabled_ = true;
   should_redraw_ = true;
+  instruction_count_ = 0;
+  dirty_lines_ = 0;
+  translation_ = nullptr;
 
   std::random_device rd;
   rng_eng_ = std::default_random_engine(rd());
@@ -44,22 +51,54 @@ bool Chip8::Load(const std::string &file_path) {
   auto input_it = std::istreambuf_iterator<char>(input);
   auto eos = std::istreambuf_iterator<char>();
   std::vector<uint8_t> rom(input_it, eos);
-  if (rom.size() > (MEMORY_LIMIT - ROM_LOCATION)) {
+  input.close();
+  return Load(rom.data(), rom.size());
+}
+
+bool Chip8::Load(const uint8_t *rom, size_t size) {
+  Reset();
+
+  if (size > (MEMORY_LIMIT - ROM_LOCATION)) {
     return false;
   }
 
-  std::copy(rom.begin(), rom.end(), mem_.begin() + ROM_LOCATION);
-  input.close();
+  std::copy(rom, rom + size, mem_.begin() + ROM_LOCATION);
   return true;
 }
 
+bool Chip8::UseTranslation(const TranslatedProgram *program) {
+  translation_ = nullptr;
+  if (program == nullptr) {
+    return true;
+  }
+  if (program->rom_size > MEMORY_LIMIT - ROM_LOCATION
+      || !std::equal(program->rom, program->rom + program->rom_size, mem_.begin() + ROM_LOCATION)) {
+    return false;
+  }
+
+  translation_ = program;
+  dirty_lines_ = 0;
+  return true;
+}
+
+uint64_t Chip8::InstructionCount() const {
+  return instruction_count_;
+}
+
 bool Chip8::ShouldRedraw() {
   return should_redraw_;
 }
 
 void Chip8::Redraw(std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT> &buf) {
-  std::transform(gfx_.begin(), gfx_.end(), buf.begin(),
-                 [](uint8_t pixel) -> uint32_t { return (0x00FFFFFFu * pixel) | 0xFF000000u; });
+  Redraw(buf.data(), SCREEN_WIDTH);
+}
+
+void Chip8::Redraw(uint32_t *buf, size_t pitch) {
+  for (size_t y = 0; y < SCREEN_HEIGHT; y++) {
+    auto row = gfx_.begin() + y * SCREEN_WIDTH;
+    std::transform(row, row + SCREEN_WIDTH, buf + y * pitch,
+                   [](uint8_t pixel) -> uint32_t { return (0x00FFFFFFu * pixel) | 0xFF000000u; });
+  }
   should_redraw_ = false;
 }
 
@@ -71,6 +110,21 @@ void Chip8::KeyUp(int key_index) {
   keys_[key_index] = false;
 }
 
+void Chip8::SetSoundEnabled(bool enabled) {
+  sound_enabled_ = enabled;
+}
+
+void Chip8::Seed(uint32_t seed) {
+  rng_eng_.seed(seed);
+}
+
+bool Chip8::SameState(const Chip8 &other) const {
+  return keys_ == other.keys_ && gfx_ == other.gfx_ && stack_ == other.stack_ && mem_ == other.mem_
+      && V_ == other.V_ && I_ == other.I_ && sp_ == other.sp_ && pc_ == other.pc_
+      && delay_timer_ == other.delay_timer_ && sound_timer_ == other.sound_timer_
+      && instruction_count_ == other.instruction_count_ && rng_eng_ == other.rng_eng_;
+}
+
 void Chip8::Step() {
   opcode_ = mem_[pc_] << 8u | mem_[pc_ + 1];  // two bytes
 
@@ -94,7 +148,9 @@ void Chip8::Step() {
         }
           // 00EE Return from a subroutine
         case 0xEE: {
-          pc_ = stack_[--sp_];
+          // the stack wraps rather than running into memory
+          sp_ = static_cast<uint16_t>((sp_ + STACK_LIMIT - 1) % STACK_LIMIT);
+          pc_ = stack_[sp_];
           pc_ += 2;
           break;
         }
@@ -115,7 +171,8 @@ void Chip8::Step() {
 
     case 0x2000: {
       // 2NNN Execute subroutine starting at address NNN
-      stack_[sp_++] = pc_;
+      stack_[sp_] = pc_;
+      sp_ = static_cast<uint16_t>((sp_ + 1) % STACK_LIMIT);
       pc_ = NNN;
       break;
     }
@@ -280,23 +337,7 @@ void Chip8::Step() {
     case 0xD000: {
       // DXYN Draw a sprite at position VX, VY with N bytes of sprite data starting at the address stored in I
       //      Set VF to 01 if any set pixels are changed to unset, and 00 otherwise
-      VF = 0;
-      uint8_t pixel;
-
-      for (auto yl = 0; yl < N; yl++) {
-        pixel = mem_[I_ + yl];
-        for (uint8_t xl = 0; xl < 8; xl++) {
-          if ((pixel & (0x80u >> xl)) != 0) {
-            auto &buf_pix = gfx_[VX + xl + ((VY + yl) * 64)];
-            if (buf_pix == 1) {
-              VF = 1;
-            }
-            buf_pix ^= 1;
-          }
-        }
-      }
-
-      should_redraw_ = true;
+      Draw((opcode_ & 0x0F00u) >> 8u, (opcode_ & 0x00F0u) >> 4u, N);
       pc_ += 2;
       break;
     }
@@ -378,27 +419,21 @@ void Chip8::Step() {
           // FX33 Store the binary-coded decimal equivalent of the value stored in register VX
           //      at addresses I, I+1, and I+2
         case 0x33: {
-          mem_[I_] = static_cast<uint8_t>(VX / 100);
-          mem_[I_ + 1] = static_cast<uint8_t>((VX / 10) % 10);
-          mem_[I_ + 2] = static_cast<uint8_t>((VX % 100) % 10);
+          StoreBcd((opcode_ & 0x0F00u) >> 8u);
           pc_ += 2;
           break;
         }
           // FX55 Store the values of registers V0 to VX inclusive in memory starting at address I
           //      I is set to I + X + 1 after operation
         case 0x55: {
-          int xval = (opcode_ & 0x0F00) >> 8;
-          std::copy_n(V_.begin(), xval + 1, mem_.begin() + I_);
-          I_ = static_cast<uint16_t>(I_ + xval + 1);
+          StoreRegisters((opcode_ & 0x0F00u) >> 8u);
           pc_ += 2;
           break;
         }
           // FX65 Fill registers V0 to VX inclusive with the values stored in memory starting at address I
           //      I is set to I + X + 1 after operation
         case 0x65: {
-          int xval = (opcode_ & 0x0F00) >> 8;
-          std::copy_n(mem_.begin() + I_, xval + 1, V_.begin());
-          I_ = static_cast<uint16_t>(I_ + xval + 1);
+          LoadRegisters((opcode_ & 0x0F00u) >> 8u);
           pc_ += 2;
           break;
         }
@@ -415,15 +450,93 @@ void Chip8::Step() {
     }
   }
 
-  if (delay_timer_ > 0) {
-    delay_timer_--;
+  Tick(1);
+  instruction_count_++;
+}
+
+void Chip8::Run(uint64_t count) {
+  while (count > 0) {
+    if (translation_ != nullptr) {
+      uint64_t executed = translation_->run(*this, count);
+      instruction_count_ += executed;
+      count -= executed;
+      if (count == 0) {
+        break;
+      }
+    }
+    // no translated block here, it doesn't fit, or its code was overwritten
+    Step();
+    count--;
   }
+}
+
+void Chip8::Tick(uint32_t count) {
+  delay_timer_ = static_cast<uint8_t>(delay_timer_ - std::min<uint32_t>(count, delay_timer_));
 
   if (sound_timer_ > 0) {
-    std::cout << '\a';  // xd
-    std::cout.flush();
-    sound_timer_--;
+    auto beeps = std::min<uint32_t>(count, sound_timer_);
+    if (sound_enabled_) {
+      std::cout << std::string(beeps, '\a');  // xd
+      std::cout.flush();
+    }
+    sound_timer_ = static_cast<uint8_t>(sound_timer_ - beeps);
   }
 }
 
+void Chip8::Write(uint16_t address, uint8_t value) {
+  if (address >= MEMORY_LIMIT) {
+    return;
+  }
+  // data that happens to share a line with code doesn't invalidate it
+  if (mem_[address] != value && translation_ != nullptr
+      && ((translation_->code_map[address / 8] >> (address % 8)) & 0x1u) != 0) {
+    dirty_lines_ |= uint64_t{1} << (address / CODE_LINE_SIZE);
+  }
+  mem_[address] = value;
+}
+
+void Chip8::Draw(uint8_t x, uint8_t y, uint8_t n) {
+  auto &VX = V_[x];
+  auto &VY = V_[y];
+  auto &VF = V_[0xFu];
+
+  VF = 0;
+  uint8_t pixel;
+
+  for (auto yl = 0; yl < n; yl++) {
+    pixel = mem_[I_ + yl];
+    for (uint8_t xl = 0; xl < 8; xl++) {
+      if ((pixel & (0x80u >> xl)) != 0) {
+        // a sprite running off the bottom wraps to the top, rather than on into stack_ and mem_
+        auto &buf_pix = gfx_[(VX + xl + ((VY + yl) * 64)) % gfx_.size()];
+        if (buf_pix == 1) {
+          VF = 1;
+        }
+        buf_pix ^= 1;
+      }
+    }
+  }
+
+  should_redraw_ = true;
+}
+
+void Chip8::StoreBcd(uint8_t x) {
+  auto VX = V_[x];
+  Write(I_, static_cast<uint8_t>(VX / 100));
+  Write(I_ + 1, static_cast<uint8_t>((VX / 10) % 10));
+  Write(I_ + 2, static_cast<uint8_t>((VX % 100) % 10));
+}
+
+void Chip8::StoreRegisters(uint8_t x) {
+  for (uint8_t i = 0; i <= x; i++) {
+    Write(I_ + i, V_[i]);
+  }
+  I_ = static_cast<uint16_t>(I_ + x + 1);
+}
+
+void Chip8::LoadRegisters(uint8_t x) {
+  std::copy_n(mem_.begin() + I_, x + 1, V_.begin());
+  I_ = static_cast<uint16_t>(I_ + x + 1);
+}
+
 } // namespace chip8
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "include/frame_stats.h"
+
+namespace chip8 {
+
+LatencyHistogram::LatencyHistogram() {
+  Reset();
+}
+
+void LatencyHistogram::Reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+}
+
+size_t LatencyHistogram::IndexOf(uint64_t value) {
+  // values below SUB_BUCKET_COUNT are stored exactly in magnitude 0
+  if (value < SUB_BUCKET_COUNT) {
+    return static_cast<size_t>(value);
+  }
+  // otherwise keep the top SUB_BUCKET_BITS + 1 bits, the leading one selects the magnitude
+  auto msb = static_cast<size_t>(63 - __builtin_clzll(value));
+  size_t shift = msb - SUB_BUCKET_BITS;
+  size_t magnitude = shift + 1;
+  size_t sub_bucket = static_cast<size_t>(value >> shift) - SUB_BUCKET_COUNT;
+  return magnitude * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t LatencyHistogram::HighestEquivalent(size_t index) {
+  size_t magnitude = index / SUB_BUCKET_COUNT;
+  size_t sub_bucket = index % SUB_BUCKET_COUNT;
+  if (magnitude == 0) {
+    return sub_bucket;
+  }
+  size_t shift = magnitude - 1;
+  uint64_t lowest = static_cast<uint64_t>(SUB_BUCKET_COUNT + sub_bucket) << shift;
+  return lowest + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+  counts_[IndexOf(value)]++;
+  count_++;
+  sum_ += value;
+  max_ = std::max(max_, value);
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  auto target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * count_));
+  target = std::max<uint64_t>(target, 1);
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); i++) {
+    seen += counts_[i];
+    if (seen >= target) {
+      return std::min(HighestEquivalent(i), max_);
+    }
+  }
+  return max_;
+}
+
+const char *StageName(Stage stage) {
+  switch (stage) {
+    case Stage::EMULATE: return "emulate";
+    case Stage::CONVERT: return "convert";
+    case Stage::UPLOAD: return "upload";
+    case Stage::PRESENT: return "present";
+    case Stage::SLEEP: return "oversleep";
+    case Stage::FRAME: return "frame";
+    case Stage::INPUT: return "input";
+    default: return "?";
+  }
+}
+
+FrameStats::FrameStats(double nominal_hz)
+    : nominal_hz_(nominal_hz), instructions_(0), interval_start_(Clock::now()), has_presented_(false) {}
+
+void FrameStats::FramePresented(Clock::time_point when) {
+  if (has_presented_) {
+    Record(Stage::FRAME, last_present_, when);
+  }
+  last_present_ = when;
+  has_presented_ = true;
+}
+
+double FrameStats::SpeedRatio(Clock::time_point now) const {
+  double wall_sec = std::chrono::duration<double>(now - interval_start_).count();
+  if (wall_sec <= 0.0 || nominal_hz_ <= 0.0) {
+    return 0.0;
+  }
+  return (instructions_ / nominal_hz_) / wall_sec;
+}
+
+namespace {
+
+double ToMillis(uint64_t ns) {
+  return static_cast<double>(ns) / 1e6;
+}
+
+}  // namespace
+
+std::string FrameStats::Summary(Clock::time_point now) const {
+  const auto &frame = Histogram(Stage::FRAME);
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(2)
+      << "frame p50 " << ToMillis(frame.Percentile(50)) << "ms"
+      << " p99 " << ToMillis(frame.Percentile(99)) << "ms"
+      << " | input p50 " << ToMillis(Histogram(Stage::INPUT).Percentile(50)) << "ms"
+      << " | speed " << SpeedRatio(now) << "x";
+  return out.str();
+}
+
+void FrameStats::Dump(std::ostream &os, Clock::time_point now) const {
+  // format locally, so the caller's stream keeps its own flags and precision
+  std::ostringstream out;
+  out << "[stats] " << Summary(now) << "\n";
+  out << "[stats] " << std::setw(10) << "stage"
+      << std::setw(10) << "count"
+      << std::setw(10) << "p50 ms"
+      << std::setw(10) << "p99 ms"
+      << std::setw(10) << "max ms" << "\n";
+  out << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    const auto &histogram = histograms_[i];
+    out << "[stats] " << std::setw(10) << StageName(static_cast<Stage>(i))
+        << std::setw(10) << histogram.Count()
+        << std::setw(10) << ToMillis(histogram.Percentile(50))
+        << std::setw(10) << ToMillis(histogram.Percentile(99))
+        << std::setw(10) << ToMillis(histogram.Max()) << "\n";
+  }
+  os << out.str() << std::flush;
+}
+
+void FrameStats::StartInterval(Clock::time_point now) {
+  for (auto &histogram : histograms_) {
+    histogram.Reset();
+  }
+  instructions_ = 0;
+  interval_start_ = now;
+}
+
+}  // namespace chip8
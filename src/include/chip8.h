@@ -3,6 +3,7 @@
 #include <bitset>
 #include <cstdint>
 #include <random>
+#include <string>
 
 namespace chip8 {
 
@@ -14,6 +15,7 @@ constexpr size_t NUM_REGISTERS = 16;        ///< chip8 num registers
 constexpr size_t MEMORY_LIMIT = 4096;       ///< chip8 typical memory
 constexpr size_t STACK_LIMIT = 16;          ///< chip8 typical stack size
 constexpr uint16_t ROM_LOCATION = 0x200;
+constexpr size_t CODE_LINE_SIZE = MEMORY_LIMIT / 64;  ///< granularity of self-modifying code detection
 
 /* Built-in chip8 font utilities. */
 constexpr std::array<uint8_t, 80> FONTSET{
@@ -35,6 +37,20 @@ constexpr std::array<uint8_t, 80> FONTSET{
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+class Chip8;
+
+/**
+ * \brief A ROM translated ahead of time by chip8aot, along with the ROM image itself.
+ */
+struct TranslatedProgram {
+  const char *name;                                 ///< ROM name
+  const uint8_t *rom;                               ///< ROM image the program was translated from
+  size_t rom_size;                                  ///< size of rom
+  size_t num_blocks;                                ///< number of translated basic blocks
+  const uint8_t *code_map;                          ///< MEMORY_LIMIT bits, set for bytes that blocks were translated from
+  uint64_t (*run)(Chip8 &chip8, uint64_t budget);   ///< runs blocks from pc, returns instructions executed
+};
+
 /**
  * \brief chip8 interpreter.
  *
@@ -58,8 +74,36 @@ class Chip8 {
    */
   bool Load(const std::string &file_path);
 
+  /**
+   * Loads the ROM image into the chip8.
+   * @param rom ROM image
+   * @param size size of the ROM image in bytes
+   * @return true if loaded successfully, false otherwise
+   */
+  bool Load(const uint8_t *rom, size_t size);
+
+  /**
+   * Use ahead-of-time translated blocks in Run() where possible.
+   * Must be called after Load(), with the program translated from the loaded ROM.
+   * @param program translated program, or nullptr to go back to interpreting only
+   * @return true if the program matches the loaded ROM, false otherwise
+   */
+  bool UseTranslation(const TranslatedProgram *program);
+
   void Step();
 
+  /**
+   * Executes count instructions, as if by calling Step() count times.
+   * Translated blocks are used where they fit and their code has not been overwritten.
+   * @param count number of instructions to execute
+   */
+  void Run(uint64_t count);
+
+  /**
+   * @return number of instructions executed since the last Reset()
+   */
+  uint64_t InstructionCount() const;
+
   /**
    * @return true if we have an update for the screen
    */
@@ -71,6 +115,13 @@ class Chip8 {
    */
   void Redraw(std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT> &buf);
 
+  /**
+   * Redraws the current chip8 screen into a SCREEN_WIDTH x SCREEN_HEIGHT region of a larger buffer.
+   * @param buf top-left pixel of the destination region
+   * @param pitch distance between rows of buf, in pixels
+   */
+  void Redraw(uint32_t *buf, size_t pitch);
+
   /**
    * Press the key at the given index.
    * @param key_index index of key pressed [0, 15]
@@ -83,7 +134,44 @@ class Chip8 {
    */
   void KeyUp(int key_index);
 
+  /**
+   * Enable or disable the terminal boop while the sound timer runs. Enabled after Reset().
+   * @param enabled whether to boop
+   */
+  void SetSoundEnabled(bool enabled);
+
+  /**
+   * Reseed the random number generator used by CXNN, for reproducible runs.
+   * @param seed new seed
+   */
+  void Seed(uint32_t seed);
+
+  /**
+   * @return true if other is in the same machine state: registers, timers, stack, memory, screen, keys and rng
+   */
+  bool SameState(const Chip8 &other) const;
+
  private:
+  friend class Translated;  ///< code generated by chip8aot
+
+  /** Count down the timers as if count instructions were executed. */
+  void Tick(uint32_t count);
+
+  /** Write a byte of memory, noting the line as dirty if translated code changed. */
+  void Write(uint16_t address, uint8_t value);
+
+  /** DXYN with VX = V_[x] and VY = V_[y]. */
+  void Draw(uint8_t x, uint8_t y, uint8_t n);
+
+  /** FX33 with VX = V_[x]. */
+  void StoreBcd(uint8_t x);
+
+  /** FX55 with X = x. */
+  void StoreRegisters(uint8_t x);
+
+  /** FX65 with X = x. */
+  void LoadRegisters(uint8_t x);
+
   std::bitset<NUM_KEYS> keys_;                                ///< keypad
 
   std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT> gfx_;     ///< graphics buffer
@@ -99,11 +187,17 @@ class Chip8 {
 
   uint8_t delay_timer_;                                       ///< delay timer
   uint8_t sound_timer_;                                       ///< sound timer
+  bool sound_enabled_;                                        ///< whether the sound timer boops
 
   std::default_random_engine rng_eng_;                        ///< rng engine
   std::uniform_int_distribution<uint8_t> rng_;                ///< random number generator
 
   bool should_redraw_;                                        ///< whether the chip8 should redraw
+
+  uint64_t instruction_count_;                                ///< instructions executed since reset
+
+  const TranslatedProgram *translation_;                      ///< translated ROM, nullptr if none
+  uint64_t dirty_lines_;                                      ///< memory lines written with new values
 };
 
 }  // namespace chip8
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace chip8 {
+
+/**
+ * \brief Fixed-size log-linear latency histogram, in the spirit of HdrHistogram.
+ *
+ * Values are bucketed by magnitude (power of two) and then linearly within each magnitude,
+ * so every recorded value is kept to within 1/SUB_BUCKET_COUNT relative precision.
+ * Recording is a couple of bit operations and an increment; nothing is allocated.
+ */
+class LatencyHistogram {
+ public:
+  static constexpr size_t SUB_BUCKET_BITS = 4;                      ///< log2 of linear buckets per magnitude
+  static constexpr size_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS; ///< linear buckets per magnitude
+  static constexpr size_t MAGNITUDE_COUNT = 64 - SUB_BUCKET_BITS + 1;  ///< magnitudes covering uint64_t
+
+  LatencyHistogram();
+
+  /**
+   * Forget all recorded values.
+   */
+  void Reset();
+
+  /**
+   * Record a single value.
+   * @param value value to be recorded, e.g. a duration in nanoseconds
+   */
+  void Record(uint64_t value);
+
+  /**
+   * @param percentile percentile in [0, 100]
+   * @return highest value equivalent to the recorded value at the given percentile, 0 if empty
+   */
+  uint64_t Percentile(double percentile) const;
+
+  /** @return number of recorded values */
+  uint64_t Count() const { return count_; }
+
+  /** @return largest recorded value */
+  uint64_t Max() const { return max_; }
+
+  /** @return mean of recorded values */
+  double Mean() const { return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_; }
+
+ private:
+  static size_t IndexOf(uint64_t value);
+  static uint64_t HighestEquivalent(size_t index);
+
+  std::array<uint64_t, MAGNITUDE_COUNT * SUB_BUCKET_COUNT> counts_;   ///< bucket counts
+  uint64_t count_;                                                    ///< total values recorded
+  uint64_t sum_;                                                      ///< sum of values recorded
+  uint64_t max_;                                                      ///< largest value recorded
+};
+
+/** Stages of the host pipeline that FrameStats keeps a histogram for. */
+enum class Stage : size_t {
+  EMULATE = 0,  ///< Chip8::Step() batch run to catch up with the wall clock
+  CONVERT,      ///< Chip8::Redraw(), on frames where something was converted
+  UPLOAD,       ///< SDL_UpdateTexture(), on frames where something was uploaded
+  PRESENT,      ///< SDL_RenderClear() + SDL_RenderCopy() + SDL_RenderPresent()
+  SLEEP,        ///< oversleep of std::this_thread::sleep_for() past the requested duration
+  FRAME,        ///< present to present on consecutive refreshes, one period unless a vsync was missed
+  INPUT,        ///< key press arrival to the present of the first frame that saw it
+  NUM_STAGES
+};
+
+constexpr size_t NUM_STAGES = static_cast<size_t>(Stage::NUM_STAGES);
+
+/**
+ * \brief Per-stage timing of the host pipeline plus emulated vs wall-clock speed.
+ *
+ * All durations are in nanoseconds. Histograms cover the current reporting interval, which is
+ * restarted by StartInterval().
+ */
+class FrameStats {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @param nominal_hz instruction rate that counts as running at 1.0x speed
+   */
+  explicit FrameStats(double nominal_hz);
+
+  /**
+   * Record a duration against a stage.
+   * @param stage pipeline stage
+   * @param ns duration in nanoseconds
+   */
+  void Record(Stage stage, uint64_t ns) { histograms_[static_cast<size_t>(stage)].Record(ns); }
+
+  /**
+   * Record a duration between two time points against a stage.
+   */
+  void Record(Stage stage, Clock::time_point start, Clock::time_point end) {
+    Record(stage, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+  }
+
+  /**
+   * Account for emulated instructions executed in this interval.
+   * @param count number of instructions
+   */
+  void AddInstructions(uint64_t count) { instructions_ += count; }
+
+  /**
+   * Mark that a frame was presented at the given time.
+   */
+  void FramePresented(Clock::time_point when);
+
+  /**
+   * Mark that a refresh went by without a present because nothing changed.
+   * The next present starts a new FRAME interval, so FRAME measures pacing rather than how often the ROM draws.
+   */
+  void FrameSkipped() { has_presented_ = false; }
+
+  /** @return histogram for the given stage */
+  const LatencyHistogram &Histogram(Stage stage) const { return histograms_[static_cast<size_t>(stage)]; }
+
+  /** @return emulated time over wall-clock time for the current interval */
+  double SpeedRatio(Clock::time_point now) const;
+
+  /** @return one-line p50/p99 summary, suitable for a window title */
+  std::string Summary(Clock::time_point now) const;
+
+  /**
+   * Write a per-stage table of the current interval to os.
+   * @param os destination stream
+   * @param now current time
+   */
+  void Dump(std::ostream &os, Clock::time_point now) const;
+
+  /**
+   * Clear all histograms and counters and start a new interval.
+   * @param now current time
+   */
+  void StartInterval(Clock::time_point now);
+
+  /** @return start of the current interval */
+  Clock::time_point IntervalStart() const { return interval_start_; }
+
+ private:
+  std::array<LatencyHistogram, NUM_STAGES> histograms_;  ///< one histogram per stage
+  double nominal_hz_;                                    ///< instructions per second at 1.0x
+  uint64_t instructions_;                                ///< instructions executed this interval
+  Clock::time_point interval_start_;                     ///< start of the current interval
+  Clock::time_point last_present_;                       ///< last FramePresented() time
+  bool has_presented_;                                   ///< whether last_present_ is valid
+};
+
+/** @return short human-readable name of the stage */
+const char *StageName(Stage stage);
+
+}  // namespace chip8
@@ -1,11 +1,19 @@
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "SDL2/SDL.h"
 
 #include "include/chip8.h"
+#include "include/frame_stats.h"
 
 constexpr int EXIT_CODE_ERR = 1;
 constexpr int EXIT_CODE_BAD_LOAD = 2;
@@ -14,6 +22,32 @@ constexpr const char *EMU_TITLE = "chip8";
 constexpr int EMU_HEIGHT = 600;
 constexpr int EMU_WIDTH = 600;
 constexpr int DEFAULT_SLEEP_MICROSEC = 100;
+constexpr int MIN_SLEEP_MICROSEC = 1;
+constexpr int MAX_SLEEP_MICROSEC = 1000000;                           ///< slowest is one instruction a second
+
+constexpr double EMU_NOMINAL_HZ = 1000000.0 / DEFAULT_SLEEP_MICROSEC;  ///< instruction rate reported as 1.0x
+constexpr auto STATS_INTERVAL = std::chrono::seconds(5);              ///< how often stats are dumped and reset
+constexpr auto OVERLAY_REFRESH = std::chrono::milliseconds(250);      ///< how often the overlay is refreshed
+constexpr double OVERLAY_FULL_SCALE_NS = 1e9 / 60.0;                  ///< overlay bar length is one 60Hz frame
+constexpr int OVERLAY_BAR_HEIGHT = 12;
+
+constexpr int DEFAULT_REFRESH_HZ = 60;                                ///< assumed if the display won't say
+constexpr auto PRESENT_MARGIN = std::chrono::microseconds(2000);      ///< present this long before vsync
+constexpr auto POLL_INTERVAL = std::chrono::microseconds(1000);       ///< longest sleep between input polls
+constexpr auto MAX_CATCHUP = std::chrono::milliseconds(50);          ///< fall further behind and we drop emulated time
+
+constexpr size_t GALLERY_MAX_INSTANCES = 1024;                        ///< keeps the atlas within texture limits
+
+/*
+ * A key transition, stamped with the emulated instruction it lands on.
+ * Keys are applied to the chip8 right before that instruction executes,
+ * so input timing does not depend on how often we get around to polling.
+ */
+struct InputEvent {
+  uint64_t instruction;   ///< apply before this instruction executes
+  int key_index;          ///< chip8 key [0, 15]
+  bool down;              ///< press or release
+};
 
 /*
  * We accept the popular input mapping
@@ -41,6 +75,8 @@ constexpr int DEFAULT_SLEEP_MICROSEC = 100;
 #define KEYMAP_F SDLK_v
 #define KEYMAP_FASTER SDLK_5
 #define KEYMAP_SLOWER SDLK_t
+#define KEYMAP_OVERLAY SDLK_6
+#define KEYMAP_NEXT_INSTANCE SDLK_TAB
 
 #define CASE_KEYMAP(keysym, func_call, sleep_var) \
   switch (keysym) { \
@@ -65,12 +101,481 @@ constexpr int DEFAULT_SLEEP_MICROSEC = 100;
     default: { break; } \
   }
 
+/*
+ * Draws one bar pair per pipeline stage in the top-left corner: p50 in green over p99 in red,
+ * both scaled so that a full-width bar is one 60Hz frame.
+ */
+void DrawStatsOverlay(SDL_Renderer *renderer, const chip8::FrameStats &stats) {
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+  for (size_t i = 0; i < chip8::NUM_STAGES; i++) {
+    const auto &histogram = stats.Histogram(static_cast<chip8::Stage>(i));
+    auto bar_width = [](uint64_t ns) {
+      return static_cast<int>(std::min(1.0, ns / OVERLAY_FULL_SCALE_NS) * EMU_WIDTH);
+    };
+    int y = static_cast<int>(i) * OVERLAY_BAR_HEIGHT;
+    SDL_Rect p99{0, y, bar_width(histogram.Percentile(99)), OVERLAY_BAR_HEIGHT - 2};
+    SDL_Rect p50{0, y, bar_width(histogram.Percentile(50)), OVERLAY_BAR_HEIGHT - 2};
+    SDL_SetRenderDrawColor(renderer, 0xE0, 0x40, 0x40, 0xC0);
+    SDL_RenderFillRect(renderer, &p99);
+    SDL_SetRenderDrawColor(renderer, 0x40, 0xE0, 0x40, 0xC0);
+    SDL_RenderFillRect(renderer, &p50);
+  }
+  SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+}
+
+#ifdef CHIP8_AOT
+namespace chip8 {
+extern const TranslatedProgram TRANSLATED_PROGRAM;  ///< generated by chip8aot for this binary
+}  // namespace chip8
+#endif
+
+/*
+ * Loads the ROM at rom_path, or the built-in ROM and its translation for chip8aot binaries.
+ */
+bool LoadRom(chip8::Chip8 &chip8, const char *rom_path) {
+#ifdef CHIP8_AOT
+  (void) rom_path;
+  return chip8.Load(chip8::TRANSLATED_PROGRAM.rom, chip8::TRANSLATED_PROGRAM.rom_size)
+      && chip8.UseTranslation(&chip8::TRANSLATED_PROGRAM);
+#else
+  return chip8.Load(rom_path);
+#endif
+}
+
+/*
+ * Time between vsyncs of the display the window is on.
+ */
+chip8::FrameStats::Clock::duration RefreshPeriod(SDL_Window *window) {
+  SDL_DisplayMode display_mode;
+  int refresh_hz = DEFAULT_REFRESH_HZ;
+  if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &display_mode) == 0
+      && display_mode.refresh_rate > 0) {
+    refresh_hz = display_mode.refresh_rate;
+  }
+  return std::chrono::duration_cast<chip8::FrameStats::Clock::duration>(std::chrono::seconds(1)) / refresh_hz;
+}
+
+/*
+ * Emulated time runs on a fixed schedule against the wall clock:
+ * instruction base + k is due at origin + k * sleep duration.
+ */
+class Schedule {
+ public:
+  using Clock = chip8::FrameStats::Clock;
+
+  Schedule(uint64_t base, Clock::time_point origin)
+      : base_(base), origin_(origin), sleep_duration_(DEFAULT_SLEEP_MICROSEC) {}
+
+  /** @return instruction due at t */
+  uint64_t InstructionAt(Clock::time_point t) const {
+    if (t <= origin_) {
+      return base_;
+    }
+    return base_ + static_cast<uint64_t>((t - origin_) / std::chrono::microseconds(sleep_duration_));
+  }
+
+  /** @return microseconds per instruction */
+  int SleepDuration() const { return sleep_duration_; }
+
+  /**
+   * Change speed from now on, carrying on from where the old speed had got to.
+   * @param sleep_duration new microseconds per instruction
+   * @param now current time
+   */
+  void SetSleepDuration(int sleep_duration, Clock::time_point now) {
+    base_ = InstructionAt(now);
+    origin_ = now;
+    sleep_duration_ = sleep_duration;
+  }
+
+  /**
+   * @param now current time
+   * @param executed instructions executed so far
+   * @return instruction to catch up to, dropping emulated time beyond MAX_CATCHUP behind
+   */
+  uint64_t CatchUpTarget(Clock::time_point now, uint64_t executed) {
+    uint64_t target = InstructionAt(now);
+    // always allow at least one instruction, or slow speeds would never get to run anything
+    auto max_catchup = std::max<uint64_t>(1, MAX_CATCHUP / std::chrono::microseconds(sleep_duration_));
+    if (target > executed + max_catchup) {
+      // we were stalled (e.g. window dragged), don't try to make up for it
+      base_ = executed + max_catchup;
+      origin_ = now;
+      target = base_;
+    }
+    return target;
+  }
+
+ private:
+  uint64_t base_;                ///< instruction due at origin_
+  Clock::time_point origin_;     ///< when base_ was due
+  int sleep_duration_;           ///< microseconds per instruction
+};
+
+/*
+ * Key transitions waiting to be applied to a chip8, and the keypress-to-present probe:
+ * armed by a key press, completed by the first present after the press was applied.
+ */
+class InputQueue {
+ public:
+  using Clock = chip8::FrameStats::Clock;
+
+  /**
+   * Queue a key transition.
+   * @param event key transition, stamped with the instruction it lands on
+   * @param arrival when it arrived
+   */
+  void Push(const InputEvent &event, Clock::time_point arrival) {
+    pending_.push_back(event);
+    if (event.down && !probe_armed_) {
+      probe_armed_ = true;
+      probe_applied_ = false;
+      probe_instruction_ = event.instruction;
+      probe_start_ = arrival;
+    }
+  }
+
+  /**
+   * Run chip8 up to target, applying each key right before the instruction it landed on.
+   * @return instructions executed
+   */
+  uint64_t RunUntil(chip8::Chip8 &chip8, uint64_t target) {
+    uint64_t executed = 0;
+    while (chip8.InstructionCount() < target || !pending_.empty()) {
+      while (!pending_.empty() && pending_.front().instruction <= chip8.InstructionCount()) {
+        const auto &event = pending_.front();
+        if (event.down) {
+          chip8.KeyDown(event.key_index);
+        } else {
+          chip8.KeyUp(event.key_index);
+        }
+        pending_.pop_front();
+      }
+      if (probe_armed_ && !probe_applied_ && probe_instruction_ <= chip8.InstructionCount()) {
+        probe_applied_ = true;
+      }
+      if (chip8.InstructionCount() >= target) {
+        break;
+      }
+      // run up to the next key event in one go
+      uint64_t until = target;
+      if (!pending_.empty()) {
+        until = std::min(until, pending_.front().instruction);
+      }
+      uint64_t count = until - chip8.InstructionCount();
+      chip8.Run(count);
+      executed += count;
+    }
+    return executed;
+  }
+
+  /**
+   * Drop pending transitions and let go of every key, e.g. when the keyboard moves to another chip8.
+   */
+  void Release(chip8::Chip8 &chip8) {
+    pending_.clear();
+    probe_armed_ = false;
+    for (int key_index = 0; key_index < static_cast<int>(chip8::NUM_KEYS); key_index++) {
+      chip8.KeyUp(key_index);
+    }
+  }
+
+  /** @return true if the next present shows the effect of the probed key press */
+  bool ProbeReady() const { return probe_armed_ && probe_applied_; }
+
+  /**
+   * Record the probed key press as presented.
+   * @param stats where the input stage is recorded
+   * @param presented when the present completed
+   */
+  void CompleteProbe(chip8::FrameStats &stats, Clock::time_point presented) {
+    stats.Record(chip8::Stage::INPUT, probe_start_, presented);
+    probe_armed_ = false;
+  }
+
+ private:
+  std::deque<InputEvent> pending_;    ///< not yet applied, in arrival order
+  bool probe_armed_ = false;          ///< a key press is being timed
+  bool probe_applied_ = false;        ///< the timed key press has been applied
+  uint64_t probe_instruction_ = 0;    ///< instruction the timed key press lands on
+  Clock::time_point probe_start_;     ///< arrival of the timed key press
+};
+
+/*
+ * Game loop. Instances run in lockstep and are tiled, columns wide, into one texture; a single ROM is
+ * a gallery of one. Each refresh, only instances that drew since the last frame are converted into
+ * their tile, the bounding box of those tiles goes up in a single SDL_UpdateTexture, and the texture is
+ * presented once. The keyboard drives the focused instance, picked with a click or KEYMAP_NEXT_INSTANCE.
+ */
+int RunLoop(SDL_Window *window, SDL_Renderer *renderer, SDL_Texture *texture,
+            std::vector<chip8::Chip8> &instances, size_t columns, bool dump_stats) {
+  using Clock = chip8::FrameStats::Clock;
+
+  bool is_gallery = instances.size() > 1;
+  size_t rows = (instances.size() + columns - 1) / columns;
+  size_t texture_pitch = columns * chip8::SCREEN_WIDTH;
+  std::vector<uint32_t> texture_buf(texture_pitch * rows * chip8::SCREEN_HEIGHT, 0xFF000000u);
+  int tile_width = EMU_WIDTH / static_cast<int>(columns);
+  int tile_height = EMU_HEIGHT / static_cast<int>(rows);
+  SDL_Rect texture_dst{0, 0, tile_width * static_cast<int>(columns), tile_height * static_cast<int>(rows)};
+
+  chip8::FrameStats stats(EMU_NOMINAL_HZ);
+  bool show_overlay = false;
+  auto last_overlay_refresh = Clock::now();
+  std::string title_prefix = std::string(EMU_TITLE) + " | ";
+  if (is_gallery) {
+    title_prefix += std::to_string(instances.size()) + " instances | ";
+  }
+
+  // SDL event timestamps are milliseconds since SDL_Init, line them up with our clock
+  auto sdl_epoch = Clock::now() - std::chrono::milliseconds(SDL_GetTicks());
+
+  auto refresh_period = RefreshPeriod(window);
+
+  // instances all start and stay at the same instruction count
+  Schedule schedule(instances.front().InstructionCount(), Clock::now());
+  InputQueue input;
+  auto last_poll = Clock::now();
+
+  // only the focused instance gets the keyboard and the boops
+  size_t focus = 0;
+  for (auto &instance : instances) {
+    instance.SetSoundEnabled(false);
+  }
+  instances[focus].SetSoundEnabled(true);
+  auto set_focus = [&](size_t new_focus) {
+    if (new_focus == focus) {
+      return;
+    }
+    input.Release(instances[focus]);
+    instances[focus].SetSoundEnabled(false);
+    focus = new_focus;
+    instances[focus].SetSoundEnabled(true);
+  };
+
+  auto next_vsync = Clock::now() + refresh_period;
+  auto frame_work = Clock::duration::zero();  // emulate to present of the last frame, to start early enough
+  bool force_present = true;                  // something besides the screens changed
+
+  SDL_Event sdl_event;
+  bool is_running = true;
+
+  while (is_running) {
+    // stamp input with when it arrived, not when we got around to it
+    auto poll_time = Clock::now();
+    size_t old_focus = focus;
+    while (SDL_PollEvent(&sdl_event) == 1) {
+      auto arrival = sdl_epoch + std::chrono::milliseconds(sdl_event.common.timestamp);
+      arrival = std::min(std::max(arrival, last_poll), poll_time);
+      uint64_t arrival_instruction = std::max(schedule.InstructionAt(arrival), instances[focus].InstructionCount());
+      auto queue_down = [&](int key_index) {
+        input.Push(InputEvent{arrival_instruction, key_index, true}, arrival);
+      };
+      auto queue_up = [&](int key_index) {
+        input.Push(InputEvent{arrival_instruction, key_index, false}, arrival);
+      };
+      int sleep_duration = schedule.SleepDuration();
+      switch (sdl_event.type) {
+        case SDL_QUIT:is_running = false;
+          break;
+        case SDL_KEYDOWN:
+          if (sdl_event.key.repeat != 0) {
+            break;
+          }
+          if (sdl_event.key.keysym.sym == KEYMAP_OVERLAY) {
+            show_overlay = !show_overlay;
+            force_present = true;
+            if (!show_overlay) {
+              SDL_SetWindowTitle(window, EMU_TITLE);
+            }
+          } else if (sdl_event.key.keysym.sym == KEYMAP_NEXT_INSTANCE) {
+            set_focus((focus + 1) % instances.size());
+          }
+          CASE_KEYMAP(sdl_event.key.keysym.sym, queue_down, sleep_duration)
+          break;
+        case SDL_KEYUP: {
+          // speed keys act on press only
+          int release_sleep_duration = sleep_duration;
+          CASE_KEYMAP(sdl_event.key.keysym.sym, queue_up, release_sleep_duration)
+          break;
+        }
+        case SDL_MOUSEBUTTONDOWN: {
+          // the renderer maps clicks into logical coordinates for us
+          size_t column = static_cast<size_t>(sdl_event.button.x / tile_width);
+          size_t row = static_cast<size_t>(sdl_event.button.y / tile_height);
+          if (column < columns && row * columns + column < instances.size()) {
+            set_focus(row * columns + column);
+          }
+          break;
+        }
+        default:break;
+      }
+      sleep_duration = std::min(std::max(sleep_duration, MIN_SLEEP_MICROSEC), MAX_SLEEP_MICROSEC);
+      if (sleep_duration != schedule.SleepDuration()) {
+        schedule.SetSleepDuration(sleep_duration, poll_time);
+      }
+    }
+    last_poll = poll_time;
+    force_present = force_present || (is_gallery && focus != old_focus);
+
+    // emulate and present once per refresh, as late as we dare before vsync: the frame carries the freshest
+    // input, and the cores get a whole frame of instructions at once, split only at key events
+    if (poll_time >= next_vsync - PRESENT_MARGIN - frame_work) {
+      auto emulate_start = Clock::now();
+      uint64_t target = schedule.CatchUpTarget(emulate_start, instances[focus].InstructionCount());
+      uint64_t executed = 0;
+      for (size_t i = 0; i < instances.size(); i++) {
+        if (i == focus) {
+          executed = input.RunUntil(instances[i], target);
+        } else if (instances[i].InstructionCount() < target) {
+          instances[i].Run(target - instances[i].InstructionCount());
+        }
+      }
+      auto emulate_end = Clock::now();
+      if (executed > 0) {
+        stats.Record(chip8::Stage::EMULATE, emulate_start, emulate_end);
+        stats.AddInstructions(executed);
+      }
+
+      // convert only the tiles that changed, remembering their bounding box in tiles
+      size_t dirty_left = columns, dirty_right = 0, dirty_top = rows, dirty_bottom = 0;
+      for (size_t i = 0; i < instances.size(); i++) {
+        if (!instances[i].ShouldRedraw()) {
+          continue;
+        }
+        size_t column = i % columns;
+        size_t row = i / columns;
+        instances[i].Redraw(texture_buf.data() + row * chip8::SCREEN_HEIGHT * texture_pitch
+                                + column * chip8::SCREEN_WIDTH, texture_pitch);
+        dirty_left = std::min(dirty_left, column);
+        dirty_right = std::max(dirty_right, column + 1);
+        dirty_top = std::min(dirty_top, row);
+        dirty_bottom = std::max(dirty_bottom, row + 1);
+      }
+      bool is_dirty = dirty_left < dirty_right;
+      if (is_dirty) {
+        stats.Record(chip8::Stage::CONVERT, emulate_end, Clock::now());
+      }
+
+      bool refresh_overlay = show_overlay && emulate_end - last_overlay_refresh >= OVERLAY_REFRESH;
+      bool complete_probe = input.ProbeReady();
+      if (is_dirty || refresh_overlay || complete_probe || force_present) {
+        if (is_dirty) {
+          auto upload_start = Clock::now();
+          SDL_Rect dirty{
+              static_cast<int>(dirty_left * chip8::SCREEN_WIDTH),
+              static_cast<int>(dirty_top * chip8::SCREEN_HEIGHT),
+              static_cast<int>((dirty_right - dirty_left) * chip8::SCREEN_WIDTH),
+              static_cast<int>((dirty_bottom - dirty_top) * chip8::SCREEN_HEIGHT)
+          };
+          SDL_UpdateTexture(texture, &dirty, texture_buf.data() + dirty.y * texture_pitch + dirty.x,
+                            static_cast<int>(texture_pitch * sizeof(uint32_t)));
+          stats.Record(chip8::Stage::UPLOAD, upload_start, Clock::now());
+        }
+        auto present_start = Clock::now();
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, &texture_dst);
+        if (is_gallery) {
+          SDL_Rect focus_rect{
+              static_cast<int>(focus % columns) * tile_width, static_cast<int>(focus / columns) * tile_height,
+              tile_width, tile_height
+          };
+          SDL_SetRenderDrawColor(renderer, 0xE0, 0xC0, 0x40, 0xFF);
+          SDL_RenderDrawRect(renderer, &focus_rect);
+          SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+        }
+        if (show_overlay) {
+          DrawStatsOverlay(renderer, stats);
+        }
+        SDL_RenderPresent(renderer);
+        auto present_end = Clock::now();
+
+        stats.Record(chip8::Stage::PRESENT, present_start, present_end);
+        stats.FramePresented(present_end);
+        frame_work = std::min<Clock::duration>(present_start - emulate_start, refresh_period);
+        force_present = false;
+
+        if (complete_probe) {
+          input.CompleteProbe(stats, present_end);
+        }
+
+        if (refresh_overlay) {
+          SDL_SetWindowTitle(window, (title_prefix + stats.Summary(present_end)).c_str());
+          last_overlay_refresh = present_end;
+        }
+
+        // a vsync'd present returns right after the flip, which gives us the vsync phase
+        next_vsync = present_end + refresh_period;
+      } else {
+        frame_work = std::min<Clock::duration>(Clock::now() - emulate_start, refresh_period);
+        stats.FrameSkipped();
+        next_vsync += refresh_period;
+      }
+      if (next_vsync <= Clock::now()) {
+        next_vsync = Clock::now() + refresh_period;
+      }
+    }
+
+    // sleep until the present deadline, but wake up regularly to pick up input
+    auto sleep_start = Clock::now();
+    auto requested_sleep = std::min<Clock::duration>(POLL_INTERVAL,
+                                                     next_vsync - PRESENT_MARGIN - frame_work - sleep_start);
+    if (requested_sleep > Clock::duration::zero()) {
+      std::this_thread::sleep_for(requested_sleep);
+      auto sleep_end = Clock::now();
+      auto overslept = sleep_end - sleep_start - requested_sleep;
+      stats.Record(chip8::Stage::SLEEP, static_cast<uint64_t>(
+          std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(overslept).count())));
+    }
+
+    auto now = Clock::now();
+    if (now - stats.IntervalStart() >= STATS_INTERVAL) {
+      if (dump_stats) {
+        stats.Dump(std::cout, now);
+      }
+      stats.StartInterval(now);
+    }
+  }
+
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
 
-  if (argc != 2) {
-    std::cout << "Usage: chip8cpp <ROM>" << std::endl;
+  bool dump_stats = false;
+  bool bad_args = false;
+  size_t gallery_size = 0;
+  std::vector<const char *> rom_paths;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--stats") == 0) {
+      dump_stats = true;
+    } else if (std::strcmp(argv[i], "--gallery") == 0) {
+      if (i + 1 == argc) {
+        bad_args = true;
+        break;
+      }
+      gallery_size = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+      bad_args = bad_args || gallery_size == 0 || gallery_size > GALLERY_MAX_INSTANCES;
+    } else {
+      rom_paths.push_back(argv[i]);
+    }
+  }
+
+#ifdef CHIP8_AOT
+  // the ROM is built in
+  if (bad_args || !rom_paths.empty()) {
+    std::cout << "Usage: " << argv[0] << " [--stats] [--gallery N]" << std::endl;
     return EXIT_CODE_ERR;
   }
+  rom_paths.push_back(chip8::TRANSLATED_PROGRAM.name);
+#else
+  // a gallery cycles through as many ROMs as it's given
+  if (bad_args || rom_paths.empty() || (gallery_size == 0 && rom_paths.size() > 1)) {
+    std::cout << "Usage: chip8cpp [--stats] <ROM>" << std::endl;
+    std::cout << "       chip8cpp [--stats] --gallery N <ROM> [ROM...]" << std::endl;
+    return EXIT_CODE_ERR;
+  }
+#endif
 
   std::cout << "Keyboard \t==> Chip8" << std::endl;
   std::cout << static_cast<char>(KEYMAP_1) << " "
@@ -93,6 +598,10 @@ int main(int argc, char *argv[]) {
             << ": faster [" << static_cast<char>(KEYMAP_FASTER)
             << "] slower [" << static_cast<char>(KEYMAP_SLOWER)
             << "]" << std::endl;
+  std::cout << "Timing overlay [" << static_cast<char>(KEYMAP_OVERLAY) << "]" << std::endl;
+  if (gallery_size > 0) {
+    std::cout << "Gallery focus: next [Tab] or click" << std::endl;
+  }
 
 
   // I _could_ refactor this, but I doubt it will change or be swapped out
@@ -132,12 +641,21 @@ int main(int argc, char *argv[]) {
 
   SDL_RenderSetLogicalSize(renderer, EMU_WIDTH, EMU_HEIGHT);
 
+  // a gallery is a grid of screens, about as tall as it is wide
+  size_t columns = 1;
+  size_t rows = 1;
+  if (gallery_size > 0) {
+    columns = static_cast<size_t>(std::ceil(std::sqrt(gallery_size * chip8::SCREEN_HEIGHT
+                                                      / static_cast<double>(chip8::SCREEN_WIDTH))));
+    rows = (gallery_size + columns - 1) / columns;
+  }
+
   SDL_Texture *texture = SDL_CreateTexture(
-      renderer,                     // create a texture for the renderer
-      SDL_PIXELFORMAT_ARGB8888,     // with this arbitrarily picked format
-      SDL_TEXTUREACCESS_STREAMING,  // texture will change frequently
-      chip8::SCREEN_WIDTH,          // width SCREEN_WIDTH
-      chip8::SCREEN_HEIGHT          // height SCREEN_HEIGHT
+      renderer,                                         // create a texture for the renderer
+      SDL_PIXELFORMAT_ARGB8888,                         // with this arbitrarily picked format
+      SDL_TEXTUREACCESS_STREAMING,                      // texture will change frequently
+      static_cast<int>(columns * chip8::SCREEN_WIDTH),  // width SCREEN_WIDTH per column
+      static_cast<int>(rows * chip8::SCREEN_HEIGHT)     // height SCREEN_HEIGHT per row
   );
   if (texture == nullptr) {
     std::cout << "[ERR/SDL_CreateTexture] " << SDL_GetError() << std::endl;
@@ -147,45 +665,24 @@ int main(int argc, char *argv[]) {
     return EXIT_CODE_ERR;
   }
 
-  // game loop
-
-  std::array<uint32_t, chip8::SCREEN_WIDTH * chip8::SCREEN_HEIGHT> texture_buf{};
-  chip8::Chip8 chip8;
-  SDL_Event sdl_event;
-  bool is_running = true;
-
-  if (!chip8.Load(argv[1])) {
-    SDL_DestroyTexture(texture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-    return EXIT_CODE_BAD_LOAD;
-  }
-
-  int sleep_duration = DEFAULT_SLEEP_MICROSEC;
+  // game loop, a single ROM is a gallery of one
 
-  while (is_running) {
-    chip8.Step();
-    while (SDL_PollEvent(&sdl_event) == 1) {
-      switch (sdl_event.type) {
-        case SDL_QUIT:is_running = false;
-          break;
-        case SDL_KEYDOWN:CASE_KEYMAP(sdl_event.key.keysym.sym, chip8.KeyDown, sleep_duration)
-          break;
-        case SDL_KEYUP:CASE_KEYMAP(sdl_event.key.keysym.sym, chip8.KeyUp, sleep_duration)
-          break;
-        default:break;
-      }
+  std::vector<chip8::Chip8> instances(std::max<size_t>(gallery_size, 1));
+  for (size_t i = 0; i < instances.size(); i++) {
+    if (!LoadRom(instances[i], rom_paths[i % rom_paths.size()])) {
+      std::cout << "[ERR/Load] " << rom_paths[i % rom_paths.size()] << std::endl;
+      SDL_DestroyTexture(texture);
+      SDL_DestroyRenderer(renderer);
+      SDL_DestroyWindow(window);
+      SDL_Quit();
+      return EXIT_CODE_BAD_LOAD;
     }
-    if (chip8.ShouldRedraw()) {
-      chip8.Redraw(texture_buf);
-      SDL_UpdateTexture(texture, nullptr, &texture_buf, chip8::SCREEN_WIDTH * sizeof(uint32_t));
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-      SDL_RenderPresent(renderer);
-    }
-    std::this_thread::sleep_for(std::chrono::microseconds(sleep_duration));
   }
 
-  return 0;
+  int exit_code = RunLoop(window, renderer, texture, instances, columns, dump_stats);
+  SDL_DestroyTexture(texture);
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+  return exit_code;
 }